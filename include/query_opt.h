@@ -16,6 +16,8 @@
 #include <vector>
 #include <random>
 #include <algorithm>
+#include <map>
+#include <utility>
 
 // Представление плана SQL‑запроса: порядок соединения таблиц и использование индексов.
 struct QueryPlan {
@@ -49,37 +51,154 @@ QueryPlan local_neighbor(const QueryPlan& q, std::mt19937& rng);
 // со скрытым «идеальным» порядком соединения и использованием индексов.
 QueryMetrics evaluate_query(const QueryPlan& q);
 
+// Та же оценка без шума: «истинные» метрики плана в модели.  Шум меняет
+// только performance, поэтому для сравнения планов между собой (архив
+// Парето) используется эта функция — иначе исход решала бы удачная выборка.
+QueryMetrics evaluate_query_exact(const QueryPlan& q);
+
+// Сбрасывает генератор шума evaluate_query() в текущем потоке.  Шум зависит
+// от всех предыдущих оценок в потоке; сброс перед поиском делает результат
+// поиска зависящим только от его входных данных.
+void reseed_evaluation_noise(unsigned seed);
+
+// Журналирование поиска: история итераций в data/csv/*.csv и сообщения
+// алгоритмов в консоль.  По умолчанию включено; режим сервиса отключает его,
+// так как для небольших планов файловый ввод-вывод дороже самого поиска.
+void set_search_logging_enabled(bool enabled);
+bool search_logging_enabled();
+
+// Веса метрик во взвешенной оценке плана.  Значения по умолчанию — веса,
+// которые использует Beam Search.
+struct ObjectiveWeights {
+    double performance      = 0.6;
+    double index_efficiency = 0.2;
+    double complexity_score = 0.2;
+};
+
+// Взвешенная сумма метрик плана.
+double weighted_score(const QueryMetrics& m, const ObjectiveWeights& w);
+
 // Функции оценки для разных алгоритмов.  HC и SA максимизируют только
 // производительность, Beam Search максимизирует взвешенную сумму всех метрик.
 double score_for_HC(const QueryMetrics& m);
 double score_for_beam(const QueryMetrics& m);
 double score_for_SA(const QueryMetrics& m);
 
-// Генерация множества соседей для плана.
+// Архив недоминируемых планов (фронт Парето) по трём метрикам, которые все
+// максимизируются.  Заполняется во время поиска; после одного прогона можно
+// выбрать лучший план для любого набора весов, не повторяя поиск.
+//
+// index_efficiency и complexity_score принимают немного дискретных значений,
+// поэтому планы группируются по этой паре и в группе хранится только план с
+// наибольшей performance.  Вставка — один поиск группы, O(log g) для g групп;
+// фронт (группы, не доминируемые другими группами) строится лениво при
+// обращении, за O(g·f) для фронта из f планов.  Не потокобезопасен.
+class ParetoArchive {
+public:
+    struct Entry {
+        QueryPlan    plan;
+        QueryMetrics metrics;
+    };
+
+    // Запоминает план, если он лучше по performance, чем план его группы.
+    // Возвращает true, если план запомнен; попадёт ли он во фронт, зависит от
+    // других групп.  m должны быть метриками без шума (evaluate_query_exact),
+    // иначе из двух планов группы выживает получивший удачную выборку шума.
+    bool insert(const QueryPlan& q, const QueryMetrics& m);
+
+    // Лучший план фронта для заданных весов; nullptr, если архив пуст.
+    // Указатель действителен до следующего insert().
+    const Entry* best_for(const ObjectiveWeights& w) const;
+
+    // Планы фронта, упорядоченные по убыванию performance.
+    const std::vector<Entry>& entries() const;
+    size_t size() const { return entries().size(); }
+    bool   empty() const { return groups_.empty(); }
+
+private:
+    // Ключ группы: (index_efficiency, complexity_score).
+    std::map<std::pair<double, double>, Entry> groups_;
+
+    mutable std::vector<Entry> front_;
+    mutable bool               frontValid_ = true;
+};
+
+// Ленивый поток соседей плана: каждый вызов next() строит очередного соседа
+// через local_neighbor(), но не более limit штук.  Потребитель может
+// остановиться раньше и не тратить время на оставшихся соседей.  Поток хранит
+// ссылки на план и генератор, поэтому не должен их переживать.
+class NeighborStream {
+public:
+    NeighborStream(const QueryPlan& q, int limit, std::mt19937& rng)
+        : base_(q), limit_(limit), rng_(rng) {}
+
+    // Записывает очередного соседа в out; false, если поток исчерпан.
+    bool next(QueryPlan& out);
+
+    // Число уже выданных соседей (оценок за шаг поиска).
+    int produced() const { return produced_; }
+
+private:
+    const QueryPlan& base_;
+    int              limit_;
+    int              produced_ = 0;
+    std::mt19937&    rng_;
+};
+
+// Генерация множества соседей для плана (все k сразу).
 std::vector<QueryPlan> generate_neighbors(const QueryPlan& q, int k, std::mt19937& rng);
 
+// Параметры Hill Climbing по умолчанию.
+constexpr int HC_DEFAULT_MAX_ITERATIONS     = 200;
+constexpr int HC_DEFAULT_NEIGHBORS_PER_STEP = 20;
+
+// Во сколько раз больше соседей шаг FirstImprovement просматривает, прежде
+// чем признать локальный максимум.  Коротких шагов много, и при выборке всего
+// neighbors_per_step поиск останавливается задолго до настоящего максимума.
+constexpr int HC_FIRST_IMPROVEMENT_PATIENCE = 3;
+
+// Стратегия шага Hill Climbing.
+enum class HCStrategy {
+    BestImprovement,   // оценить всех соседей и перейти к лучшему
+    FirstImprovement   // перейти к первому соседу, который лучше текущего плана
+};
+
 // Алгоритм Hill Climbing: ищет локальный максимум, улучшая одну метрику (performance).
+// Соседи строятся лениво; при FirstImprovement шаг заканчивается на первом
+// улучшении, а локальный максимум признаётся после
+// HC_FIRST_IMPROVEMENT_PATIENCE * neighbors_per_step неудачных соседей.  Обе
+// стратегии ограничены одним бюджетом в max_iterations * neighbors_per_step
+// оценок соседей: BestImprovement укладывается в него за max_iterations шагов,
+// FirstImprovement тратит его на большее число более коротких шагов.  Число
+// оценённых соседей на каждом шаге пишется в колонку evaluations
+// hc_history.csv.
 QueryPlan hill_climbing(const QueryPlan& start,
                         std::mt19937& rng,
-                        int max_iterations = 200,
-                        int neighbors_per_step = 20);
+                        int max_iterations = HC_DEFAULT_MAX_ITERATIONS,
+                        int neighbors_per_step = HC_DEFAULT_NEIGHBORS_PER_STEP,
+                        HCStrategy strategy = HCStrategy::BestImprovement);
 
 // Алгоритм Beam Search: рассматривает несколько путей поиска одновременно,
 // оптимизируя взвешенную комбинацию метрик.  Параметры beam_width и depth
-// задают ширину луча и глубину поиска.
+// задают ширину луча и глубину поиска.  Если передан archive, в него
+// добавляются все оценённые планы с метриками без шума (это вторая оценка
+// каждого плана).
 QueryPlan beam_search(const QueryPlan& start,
                       std::mt19937& rng,
                       int beam_width = 5,
                       int depth = 30,
-                      int neighbors_per_state = 10);
+                      int neighbors_per_state = 10,
+                      ParetoArchive* archive = nullptr);
 
 // Алгоритм имитации отжига: позволяет выходить из локальных максимумов,
 // принимая ухудшающие решения с вероятностью, зависящей от температуры.  Вначале
 // температура высокая, что стимулирует исследование, затем постепенно
-// уменьшается до T_end.
+// уменьшается до T_end.  Если передан archive, в него добавляются все
+// оценённые планы с метриками без шума (это вторая оценка каждого плана).
 QueryPlan simulated_annealing(const QueryPlan& start,
                               std::mt19937& rng,
                               int max_iterations = 1000,
                               double T_start = 1.0,
                               double T_end   = 1e-3,
-                              double alpha   = 0.99);
+                              double alpha   = 0.99,
+                              ParetoArchive* archive = nullptr);
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+//
+// Лабораторная работа 22. Режим сервиса оптимизатора
+//
+// Долгоживущий процесс принимает запросы на оптимизацию через Unix-сокет и
+// отвечает найденным планом и его метриками.  Рабочие потоки и кэш
+// результатов остаются «прогретыми» между запросами, а одинаковые запросы,
+// пришедшие одновременно, объединяются в один поиск.
+//
+// Протокол текстовый, одна строка на запрос:
+//
+//   HC   <num_tables> <seed> [best|first]
+//                              -> Hill Climbing (по умолчанию best)
+//   BEAM <num_tables> <seed>   -> Beam Search
+//   SA   <num_tables> <seed>   -> имитация отжига
+//   PING                       -> PONG
+//   SHUTDOWN                   -> BYE, сервис завершает работу
+//
+// Ответ — одна строка: "OK plan=<QueryPlan> metrics=<QueryMetrics> score=<s>"
+// или "ERR <описание>".  Стартовый план строится random_queryplan() из
+// генератора с указанным seed, а шум evaluate_query() перед поиском
+// сбрасывается зерном, выведенным из того же seed, поэтому ответ зависит
+// только от запроса и одинаковые запросы эквивалентны.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Параметры сервиса.
+struct ServiceConfig {
+    std::string socket_path       = "/tmp/sql_query_optimizer.sock";
+    int         worker_threads    = 4;      // число потоков, выполняющих запросы
+    std::size_t cache_capacity    = 256;    // число запомненных готовых ответов
+    int         max_tables        = 256;    // верхняя граница num_tables в запросе
+    std::size_t max_line_length   = 4096;   // длиннее — ERR и закрытие соединения
+    std::size_t max_pending_lines = 64;     // запросов соединения в очереди
+    int         idle_timeout_ms   = 30000;  // простой, после которого соединение закрывается
+};
+
+// Запуск сервиса: блокирует вызывающий поток до команды SHUTDOWN или
+// сигнала SIGINT/SIGTERM.  Возвращает код завершения процесса.
+int run_query_service(const ServiceConfig& cfg);
@@ -5,6 +5,7 @@
 
 #include "query_opt.h"
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <filesystem>
 #include <fstream>
@@ -13,55 +14,116 @@
 
 namespace fs = std::filesystem;
 
+// --------------------- Журналирование поиска ---------------------- //
+
+static std::atomic<bool> g_search_logging_enabled{true};
+
+void set_search_logging_enabled(bool enabled) {
+    g_search_logging_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool search_logging_enabled() {
+    return g_search_logging_enabled.load(std::memory_order_relaxed);
+}
+
+// Открывает data/csv/<file> и пишет заголовок. Если журналирование
+// отключено, возвращает закрытый поток — все записи в него пропускаются.
+static std::ofstream open_history_csv(const char* file,
+                                      const char* tag,
+                                      const char* header) {
+    std::ofstream out;
+    if (!search_logging_enabled()) {
+        out.setstate(std::ios::failbit);
+        return out;
+    }
+    fs::path csvDir = fs::path("data") / "csv";
+    fs::create_directories(csvDir);
+    fs::path path = csvDir / file;
+    out.open(path);
+    if (!out) {
+        std::cerr << "[" << tag << "] Не удалось открыть " << path << " для записи\n";
+    } else {
+        out << header << "\n";
+    }
+    return out;
+}
+
 // --------------------- Hill Climbing ---------------------- //
 
 QueryPlan hill_climbing(const QueryPlan& start,
                         std::mt19937& rng,
                         int max_iterations,
-                        int neighbors_per_step) {
+                        int neighbors_per_step,
+                        HCStrategy strategy) {
     // Подготовка CSV для истории HC
-    fs::path csvDir = fs::path("data") / "csv";
-    fs::create_directories(csvDir);
-    fs::path hcPath = csvDir / "hc_history.csv";
-    std::ofstream hcOut(hcPath);
-    if (!hcOut) {
-        std::cerr << "[HC] Не удалось открыть " << hcPath << " для записи\n";
-    } else {
-        hcOut << "iter,score,performance,index_efficiency,complexity_score\n";
-    }
+    std::ofstream hcOut = open_history_csv(
+        "hc_history.csv", "HC",
+        "iter,score,performance,index_efficiency,complexity_score,evaluations");
 
     QueryPlan   current = start;
     QueryMetrics curM   = evaluate_query(current);
     double       curScore = score_for_HC(curM);
 
+    // Бюджет оценок соседей.  BestImprovement тратит neighbors_per_step на
+    // шаг, т.е. делает ровно max_iterations шагов; FirstImprovement делает
+    // больше коротких шагов в пределах того же бюджета.
+    const long long evalBudget =
+        static_cast<long long>(max_iterations) * neighbors_per_step;
+    long long totalEvaluations = 0;
+
     // лог итерации 0
     if (hcOut) {
         hcOut << 0 << ","
               << curScore << ","
               << curM.performance << ","
               << curM.index_efficiency << ","
-              << curM.complexity_score << "\n";
+              << curM.complexity_score << ","
+              << 0 << "\n";
     }
 
-    for (int iter = 1; iter <= max_iterations; ++iter) {
+    for (int iter = 1; totalEvaluations < evalBudget; ++iter) {
         QueryPlan   bestNeighbor = current;
         QueryMetrics bestM       = curM;
         double       bestScore   = curScore;
 
-        auto neighbors = generate_neighbors(current, neighbors_per_step, rng);
-        for (const auto& n : neighbors) {
+        // Шаг FirstImprovement короткий, пока улучшения находятся, но прежде
+        // чем признать локальный максимум, просматривает больше соседей
+        int stepLimit = neighbors_per_step;
+        if (strategy == HCStrategy::FirstImprovement) {
+            stepLimit *= HC_FIRST_IMPROVEMENT_PATIENCE;
+        }
+        int limit = static_cast<int>(
+            std::min<long long>(stepLimit, evalBudget - totalEvaluations));
+        NeighborStream neighbors(current, limit, rng);
+        QueryPlan n;
+        while (neighbors.next(n)) {
             QueryMetrics m = evaluate_query(n);
             double       s = score_for_HC(m);
             if (s > bestScore) {
                 bestScore   = s;
                 bestNeighbor = n;
                 bestM        = m;
+                if (strategy == HCStrategy::FirstImprovement) break;
             }
         }
+        totalEvaluations += neighbors.produced();
 
         if (bestScore <= curScore) {
-            std::cout << "[HC] остановка на итерации " << iter
-                      << " — достигнут локальный максимум\n";
+            // Шаг без улучшения тоже пишем: его оценки входят в evaluations
+            if (hcOut) {
+                hcOut << iter << ","
+                      << curScore << ","
+                      << curM.performance << ","
+                      << curM.index_efficiency << ","
+                      << curM.complexity_score << ","
+                      << neighbors.produced() << "\n";
+            }
+            // Если бюджет кончился посреди шага, локальный максимум не доказан
+            if (search_logging_enabled() && limit == stepLimit) {
+                std::cout << "[HC] остановка на итерации " << iter
+                          << " — достигнут локальный максимум"
+                          << " (оценено соседей: " << totalEvaluations << ")\n";
+            }
             break;
         }
 
@@ -74,7 +136,8 @@ QueryPlan hill_climbing(const QueryPlan& start,
                   << curScore << ","
                   << curM.performance << ","
                   << curM.index_efficiency << ","
-                  << curM.complexity_score << "\n";
+                  << curM.complexity_score << ","
+                  << neighbors.produced() << "\n";
         }
     }
 
@@ -87,17 +150,12 @@ QueryPlan beam_search(const QueryPlan& start,
                       std::mt19937& rng,
                       int beam_width,
                       int depth,
-                      int neighbors_per_state) {
+                      int neighbors_per_state,
+                      ParetoArchive* archive) {
     // Подготовка CSV для истории Beam Search
-    fs::path csvDir = fs::path("data") / "csv";
-    fs::create_directories(csvDir);
-    fs::path beamPath = csvDir / "beam_history.csv";
-    std::ofstream beamOut(beamPath);
-    if (!beamOut) {
-        std::cerr << "[Beam] Не удалось открыть " << beamPath << " для записи\n";
-    } else {
-        beamOut << "iter,score,performance,index_efficiency,complexity_score\n";
-    }
+    std::ofstream beamOut = open_history_csv(
+        "beam_history.csv", "Beam",
+        "iter,score,performance,index_efficiency,complexity_score");
 
     std::vector<QueryPlan> beam;
     beam.push_back(start);
@@ -105,6 +163,7 @@ QueryPlan beam_search(const QueryPlan& start,
     QueryPlan    globalBest    = start;
     QueryMetrics globalBestM   = evaluate_query(start);
     double       globalBestScore = score_for_beam(globalBestM);
+    if (archive) archive->insert(start, evaluate_query_exact(start));
 
     // итерация 0
     if (beamOut) {
@@ -124,6 +183,7 @@ QueryPlan beam_search(const QueryPlan& start,
                 QueryMetrics m = evaluate_query(n);
                 double       s = score_for_beam(m);
                 candidates.push_back({s, n});
+                if (archive) archive->insert(n, evaluate_query_exact(n));
             }
         }
 
@@ -163,21 +223,17 @@ QueryPlan simulated_annealing(const QueryPlan& start,
                               int max_iterations,
                               double T_start,
                               double T_end,
-                              double alpha) {
+                              double alpha,
+                              ParetoArchive* archive) {
     // Подготовка CSV для истории SA
-    fs::path csvDir = fs::path("data") / "csv";
-    fs::create_directories(csvDir);
-    fs::path saPath = csvDir / "sa_history.csv";
-    std::ofstream saOut(saPath);
-    if (!saOut) {
-        std::cerr << "[SA] Не удалось открыть " << saPath << " для записи\n";
-    } else {
-        saOut << "iter,T,score,accepted_worse\n";
-    }
+    std::ofstream saOut = open_history_csv(
+        "sa_history.csv", "SA",
+        "iter,T,score,accepted_worse");
 
     QueryPlan   current = start;
     QueryMetrics curM   = evaluate_query(current);
     double       curScore = score_for_SA(curM);
+    if (archive) archive->insert(current, evaluate_query_exact(current));
 
     QueryPlan best      = current;
     double    bestScore = curScore;
@@ -196,6 +252,7 @@ QueryPlan simulated_annealing(const QueryPlan& start,
         QueryPlan   next    = local_neighbor(current, rng);
         QueryMetrics nextM  = evaluate_query(next);
         double       nextScore = score_for_SA(nextM);
+        if (archive) archive->insert(next, evaluate_query_exact(next));
 
         double dE = curScore - nextScore; // максимизируем score
         bool acceptedWorse = false;
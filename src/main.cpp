@@ -2,21 +2,27 @@
 //
 // Точка входа для лабораторной работы 22.
 // Программа демонстрирует работу трёх алгоритмов оптимизации SQL-запросов:
-// Hill Climbing, Beam Search и имитации отжига.
+// Hill Climbing, Beam Search и имитации отжига.  Ключ --hc выбирает стратегию
+// шага Hill Climbing в демонстрации, с ключом --serve программа запускается
+// как сервис и принимает запросы через Unix-сокет:
+//
+//   sql_query_optimizer [--hc best|first]
+//   sql_query_optimizer --serve [socket_path] [worker_threads]
 
 #include "query_opt.h"
+#include "query_service.h"
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace fs = std::filesystem;
 
-int main() {
-    std::ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-
+static int run_demo(HCStrategy hcStrategy) {
     const int NUM_TABLES = 4;
 
     std::mt19937 rng(
@@ -32,8 +38,13 @@ int main() {
               << " -> метрики " << startM << "\n\n";
 
     // -------- 1) Hill Climbing --------
-    std::cout << "==== Hill Climbing: поиск очевидных улучшений ====\n";
-    QueryPlan bestHC = hill_climbing(start, rng);
+    std::cout << "==== Hill Climbing: поиск очевидных улучшений ("
+              << (hcStrategy == HCStrategy::FirstImprovement ? "first" : "best")
+              << "-improvement) ====\n";
+    QueryPlan bestHC = hill_climbing(start, rng,
+                                     HC_DEFAULT_MAX_ITERATIONS,
+                                     HC_DEFAULT_NEIGHBORS_PER_STEP,
+                                     hcStrategy);
     QueryMetrics mHC = evaluate_query(bestHC);
     std::cout << "Лучший план (Hill Climbing): " << bestHC << "\n";
     std::cout << "Метрики:                    " << mHC
@@ -41,7 +52,9 @@ int main() {
 
     // -------- 2) Beam Search --------
     std::cout << "==== Beam Search: перебор JOIN и индексов ====\n";
-    QueryPlan bestBeam = beam_search(start, rng, 5);
+    // Архив Парето собирает недоминируемые планы из Beam Search и SA
+    ParetoArchive pareto;
+    QueryPlan bestBeam = beam_search(start, rng, 5, 30, 10, &pareto);
     QueryMetrics mBeam = evaluate_query(bestBeam);
     std::cout << "Лучший план (Beam Search):   " << bestBeam << "\n";
     std::cout << "Метрики:                     " << mBeam
@@ -62,12 +75,29 @@ int main() {
         /*max_iterations=*/2000,
         /*T_start=*/1.5,
         /*T_end=*/1e-4,
-        /*alpha=*/0.995);
+        /*alpha=*/0.995,
+        &pareto);
 
     QueryMetrics mSA = evaluate_query(bestSA);
     std::cout << "Лучший план (SA):            " << bestSA << "\n";
     std::cout << "Метрики:                     " << mSA
-              << "  (score=" << score_for_SA(mSA) << ")\n";
+              << "  (score=" << score_for_SA(mSA) << ")\n\n";
+
+    // -------- 4) Фронт Парето: выбор плана под разные приоритеты --------
+    std::cout << "==== Фронт Парето (Beam Search + SA): недоминируемых планов — "
+              << pareto.size() << " ====\n";
+    const std::pair<const char*, ObjectiveWeights> priorities[] = {
+        {"производительность", {1.0, 0.0, 0.0}},
+        {"баланс (как Beam)",  {0.6, 0.2, 0.2}},
+        {"меньше индексов",    {0.2, 0.6, 0.2}},
+        {"простота JOIN",      {0.2, 0.2, 0.6}},
+    };
+    for (const auto& [name, w] : priorities) {
+        const ParetoArchive::Entry* e = pareto.best_for(w);
+        if (!e) break;
+        std::cout << "  " << name << ": " << e->plan << " -> " << e->metrics
+                  << "  (score=" << weighted_score(e->metrics, w) << ")\n";
+    }
 
     // -------- summary.csv для Python --------
     fs::path csvDir = fs::path("data") / "csv";
@@ -106,3 +136,41 @@ int main() {
 
     return 0;
 }
+
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
+    if (argc >= 2 && std::string(argv[1]) == "--serve") {
+        ServiceConfig cfg;
+        if (argc >= 3) {
+            cfg.socket_path = argv[2];
+        }
+        if (argc >= 4) {
+            try {
+                size_t used = 0;
+                cfg.worker_threads = std::stoi(argv[3], &used);
+                if (argv[3][used] != '\0' || cfg.worker_threads < 1) {
+                    throw std::invalid_argument(argv[3]);
+                }
+            } catch (const std::exception&) {
+                std::cerr << "[ERROR] Некорректное число потоков: " << argv[3] << "\n";
+                return 1;
+            }
+        }
+        return run_query_service(cfg);
+    }
+
+    HCStrategy hcStrategy = HCStrategy::BestImprovement;
+    if (argc >= 2 && std::string(argv[1]) == "--hc") {
+        std::string name = argc >= 3 ? argv[2] : "";
+        if (name == "first") {
+            hcStrategy = HCStrategy::FirstImprovement;
+        } else if (name != "best") {
+            std::cerr << "[ERROR] Стратегия --hc должна быть best или first\n";
+            return 1;
+        }
+    }
+
+    return run_demo(hcStrategy);
+}
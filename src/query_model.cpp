@@ -5,7 +5,9 @@
 // случайных планов и их соседей, а также вычисление метрик для плана.
 
 #include "query_opt.h"
+#include <algorithm>
 #include <cmath>
+#include <utility>
 
 // Вывод QueryPlan
 std::ostream& operator<<(std::ostream& os, const QueryPlan& q) {
@@ -77,12 +79,20 @@ QueryPlan local_neighbor(const QueryPlan& q, std::mt19937& rng) {
     return n;
 }
 
-// Оценка плана запроса.
+// Генератор шума оценки.  Свой у каждого потока: в режиме сервиса оценка
+// идёт параллельно.
+static thread_local std::mt19937 noise_rng{1234567};
+
+void reseed_evaluation_noise(unsigned seed) {
+    noise_rng.seed(seed);
+}
+
+// Оценка плана запроса с заданной добавкой шума к стоимости.
 // Модель основана на скрытом «идеальном» порядке соединения (от 0 до n-1)
 // и использовании индексов для первой половины таблиц. Чем ближе план к идеалу,
 // тем ниже стоимость. Метрики нормируются так, что более низкая стоимость
 // даёт более высокие значения performance.
-QueryMetrics evaluate_query(const QueryPlan& q) {
+static QueryMetrics evaluate_with_noise(const QueryPlan& q, double noise) {
     int n = static_cast<int>(q.join_order.size());
     // Вычисляем базовую стоимость
     double cost = 10.0;
@@ -109,10 +119,7 @@ QueryMetrics evaluate_query(const QueryPlan& q) {
             }
         }
     }
-    // Вносим небольшой шум, чтобы получить локальные оптимумы
-    static std::mt19937 noise_rng{1234567};
-    std::uniform_real_distribution<double> noise_dist(-0.5, 0.5);
-    cost += noise_dist(noise_rng);
+    cost += noise;
     // Нормируем метрики
     double performance = 1.0 / (1.0 + cost);
     // Эффективность индексов: чем меньше true в use_index, тем лучше.  Мы
@@ -127,25 +134,119 @@ QueryMetrics evaluate_query(const QueryPlan& q) {
     return {performance, index_efficiency, complexity_score};
 }
 
+QueryMetrics evaluate_query(const QueryPlan& q) {
+    // Вносим небольшой шум, чтобы получить локальные оптимумы
+    std::uniform_real_distribution<double> noise_dist(-0.5, 0.5);
+    return evaluate_with_noise(q, noise_dist(noise_rng));
+}
+
+QueryMetrics evaluate_query_exact(const QueryPlan& q) {
+    return evaluate_with_noise(q, 0.0);
+}
+
 double score_for_HC(const QueryMetrics& m) {
     return m.performance;
 }
 
+double weighted_score(const QueryMetrics& m, const ObjectiveWeights& w) {
+    return w.performance * m.performance
+         + w.index_efficiency * m.index_efficiency
+         + w.complexity_score * m.complexity_score;
+}
+
 double score_for_beam(const QueryMetrics& m) {
     // Взвешенная сумма: приоритет производительности, но учитываются индекс и сложность
-    return 0.6 * m.performance + 0.2 * m.index_efficiency + 0.2 * m.complexity_score;
+    return weighted_score(m, ObjectiveWeights{});
 }
 
 double score_for_SA(const QueryMetrics& m) {
     return m.performance;
 }
 
+// Вставка в архив Парето: сравнение только с планом той же группы.
+bool ParetoArchive::insert(const QueryPlan& q, const QueryMetrics& m) {
+    auto key = std::make_pair(m.index_efficiency, m.complexity_score);
+    auto it = groups_.find(key);
+    if (it != groups_.end()) {
+        if (it->second.metrics.performance >= m.performance) {
+            return false;
+        }
+        it->second = Entry{q, m};
+    } else {
+        groups_.emplace(key, Entry{q, m});
+    }
+    frontValid_ = false;
+    return true;
+}
+
+// Фронт строится из лучших планов групп.  После сортировки по убыванию
+// метрик доминирующая группа всегда идёт раньше доминируемой, поэтому план
+// достаточно сравнить с уже принятыми во фронт: если его доминирует
+// отброшенная группа, то по транзитивности и её доминатор из фронта.
+const std::vector<ParetoArchive::Entry>& ParetoArchive::entries() const {
+    if (frontValid_) {
+        return front_;
+    }
+
+    std::vector<const Entry*> order;
+    order.reserve(groups_.size());
+    for (const auto& [key, e] : groups_) {
+        order.push_back(&e);
+    }
+    std::sort(order.begin(), order.end(), [](const Entry* a, const Entry* b) {
+        const QueryMetrics& x = a->metrics;
+        const QueryMetrics& y = b->metrics;
+        if (x.performance != y.performance) return x.performance > y.performance;
+        if (x.index_efficiency != y.index_efficiency) return x.index_efficiency > y.index_efficiency;
+        return x.complexity_score > y.complexity_score;
+    });
+
+    front_.clear();
+    for (const Entry* e : order) {
+        const QueryMetrics& m = e->metrics;
+        bool dominated = std::any_of(front_.begin(), front_.end(), [&m](const Entry& f) {
+            return f.metrics.index_efficiency >= m.index_efficiency
+                && f.metrics.complexity_score >= m.complexity_score;
+        });
+        if (!dominated) {
+            front_.push_back(*e);
+        }
+    }
+    frontValid_ = true;
+    return front_;
+}
+
+const ParetoArchive::Entry* ParetoArchive::best_for(const ObjectiveWeights& w) const {
+    const Entry* best = nullptr;
+    double bestScore = 0.0;
+    for (const auto& e : entries()) {
+        double s = weighted_score(e.metrics, w);
+        if (!best || s > bestScore) {
+            best      = &e;
+            bestScore = s;
+        }
+    }
+    return best;
+}
+
+// Очередной сосед из ленивого потока
+bool NeighborStream::next(QueryPlan& out) {
+    if (produced_ >= limit_) {
+        return false;
+    }
+    out = local_neighbor(base_, rng_);
+    ++produced_;
+    return true;
+}
+
 // Генерация множества соседей
 std::vector<QueryPlan> generate_neighbors(const QueryPlan& q, int k, std::mt19937& rng) {
     std::vector<QueryPlan> res;
     res.reserve(k);
-    for (int i = 0; i < k; ++i) {
-        res.push_back(local_neighbor(q, rng));
+    NeighborStream stream(q, k, rng);
+    QueryPlan n;
+    while (stream.next(n)) {
+        res.push_back(std::move(n));
     }
     return res;
 }
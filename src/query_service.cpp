@@ -0,0 +1,542 @@
+// SPDX-License-Identifier: MIT
+//
+// Реализация режима сервиса для лабораторной работы 22: приём запросов через
+// Unix-сокет, цикл poll по соединениям, пул рабочих потоков, объединение
+// одинаковых запросов и кэш готовых ответов.
+
+#include "query_service.h"
+#include "query_opt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Интервал (мс), с которым блокирующие ожидания проверяют флаг остановки.
+constexpr int POLL_INTERVAL_MS = 200;
+
+// Сколько секунд ответ может ждать, пока клиент его прочитает.
+constexpr int SEND_TIMEOUT_S = 5;
+
+// Второй элемент seed_seq для зерна шума оценки (см. run_optimization).
+constexpr std::uint32_t NOISE_SEED_STREAM = 1;
+
+std::atomic<bool> g_stop{false};
+
+void handle_stop_signal(int) {
+    g_stop.store(true);
+}
+
+// Разобранный запрос на оптимизацию.
+struct OptimizeRequest {
+    std::string algorithm;  // HC, BEAM или SA
+    int         num_tables = 0;
+    unsigned    seed       = 0;
+    HCStrategy  strategy   = HCStrategy::BestImprovement;  // только для HC
+
+    // Каноническая запись запроса — ключ для объединения и кэша.
+    std::string key() const {
+        std::string k = algorithm + " " + std::to_string(num_tables) + " " + std::to_string(seed);
+        if (algorithm == "HC" && strategy == HCStrategy::FirstImprovement) {
+            k += " first";
+        }
+        return k;
+    }
+};
+
+// Выполняет поиск и формирует строку ответа.
+std::string run_optimization(const OptimizeRequest& req) {
+    // Шум оценки зависит от предыдущих поисков в этом потоке; сброс делает
+    // ответ функцией запроса, что и позволяет объединять и кэшировать запросы.
+    // Зерно шума выводится из seed отдельно, чтобы шум не повторял
+    // последовательность генератора, строящего планы.
+    std::seed_seq noiseSeq{req.seed, NOISE_SEED_STREAM};
+    std::uint32_t noiseSeed = 0;
+    noiseSeq.generate(&noiseSeed, &noiseSeed + 1);
+    reseed_evaluation_noise(noiseSeed);
+    std::mt19937 rng(req.seed);
+    QueryPlan start = random_queryplan(rng, req.num_tables);
+
+    QueryPlan best;
+    double (*score)(const QueryMetrics&) = nullptr;
+    if (req.algorithm == "HC") {
+        best  = hill_climbing(start, rng,
+                              HC_DEFAULT_MAX_ITERATIONS,
+                              HC_DEFAULT_NEIGHBORS_PER_STEP,
+                              req.strategy);
+        score = score_for_HC;
+    } else if (req.algorithm == "BEAM") {
+        best  = beam_search(start, rng);
+        score = score_for_beam;
+    } else {
+        best  = simulated_annealing(start, rng);
+        score = score_for_SA;
+    }
+
+    QueryMetrics m = evaluate_query(best);
+    std::ostringstream os;
+    os << "OK plan=" << best << " metrics=" << m << " score=" << score(m);
+    return os.str();
+}
+
+// Освобождает путь к сокету перед bind().  Удаляется только сокет, к
+// которому никто не подключён (остаток завершившегося экземпляра).  Если по
+// пути лежит не сокет или на нём уже работает сервис, возвращает false.
+bool remove_stale_socket(const sockaddr_un& addr) {
+    const char* path = addr.sun_path;
+    struct stat st{};
+    if (::lstat(path, &st) < 0) {
+        if (errno == ENOENT) return true;
+        std::cerr << "[Service] Не удалось проверить " << path
+                  << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        std::cerr << "[Service] " << path << " существует и не является сокетом\n";
+        return false;
+    }
+
+    int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) {
+        std::cerr << "[Service] socket(): " << std::strerror(errno) << "\n";
+        return false;
+    }
+    bool alive = ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    int  err   = errno;
+    ::close(probe);
+    if (alive) {
+        std::cerr << "[Service] На " << path << " уже работает другой экземпляр\n";
+        return false;
+    }
+    if (err != ECONNREFUSED) {
+        std::cerr << "[Service] Не удалось проверить " << path
+                  << ": " << std::strerror(err) << "\n";
+        return false;
+    }
+    if (::unlink(path) < 0) {
+        std::cerr << "[Service] Не удалось удалить " << path
+                  << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Соединение клиента.  Читает из него только цикл poll в run(), ответы пишут
+// рабочие потоки.  Дескриптор закрывается, когда на соединение не остаётся
+// ссылок ни в цикле poll, ни в очереди задач.
+struct Connection {
+    explicit Connection(int fd_) : fd(fd_), lastActive(Clock::now()) {}
+    ~Connection() { ::close(fd); }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    const int   fd;
+    std::string buffer;  // непрочитанный хвост; только для цикла poll
+
+    // Запросы одного соединения обрабатываются по одному, чтобы ответы шли
+    // в порядке запросов: пока busy, новые строки ждут в lines.
+    std::mutex              mutex;
+    std::deque<std::string> lines;
+    bool                    busy = false;
+    Clock::time_point       lastActive;
+
+    std::mutex sendMutex;  // ответы рабочих потоков
+};
+
+// Отправляет строку целиком; false, если клиент отключился или не читает
+// ответ дольше SEND_TIMEOUT_S.
+bool send_line(Connection& conn, const std::string& text) {
+    std::string data = text + "\n";
+    std::lock_guard<std::mutex> lock(conn.sendMutex);
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(conn.fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Отправка из цикла poll перед закрытием соединения: без ожидания мьютекса и
+// места в буфере сокета, чтобы не читающий клиент не остановил цикл.  Если
+// отправить сразу не получилось, строка теряется.
+void send_line_nowait(Connection& conn, const std::string& text) {
+    std::unique_lock<std::mutex> lock(conn.sendMutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    std::string data = text + "\n";
+    ::send(conn.fd, data.data(), data.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+// Задача для пула: одна строка запроса от конкретного соединения.
+struct Task {
+    std::shared_ptr<Connection> conn;
+    std::string                 line;
+};
+
+class QueryService {
+public:
+    explicit QueryService(const ServiceConfig& cfg) : cfg_(cfg) {}
+
+    int run();
+
+private:
+    bool read_from(const std::shared_ptr<Connection>& conn);
+    bool submit(const std::shared_ptr<Connection>& conn, std::string line);
+    void enqueue(Task task);
+    bool is_idle(Connection& conn, Clock::time_point now) const;
+    void worker_loop();
+    std::string handle_line(const std::string& line);
+    std::string optimize(const OptimizeRequest& req);
+    void remember(const std::string& key, const std::string& response);
+
+    ServiceConfig cfg_;
+
+    // Очередь запросов для рабочих потоков.
+    std::mutex              queueMutex_;
+    std::condition_variable queueCv_;
+    std::deque<Task>        tasks_;
+
+    // Поиски в процессе выполнения и кэш готовых ответов.
+    std::mutex                                                    resultsMutex_;
+    std::unordered_map<std::string, std::shared_future<std::string>> inflight_;
+    std::unordered_map<std::string, std::string>                  cache_;
+    std::deque<std::string>                                       cacheOrder_;
+};
+
+// Цикл poll принимает соединения и читает из них строки, а рабочие потоки
+// получают уже готовые запросы.  Поэтому простаивающий клиент не занимает
+// поток, и даже один поток обслуживает любое число соединений.
+int QueryService::run() {
+    if (cfg_.socket_path.size() >= sizeof(sockaddr_un{}.sun_path)) {
+        std::cerr << "[Service] Слишком длинный путь к сокету: " << cfg_.socket_path << "\n";
+        return 1;
+    }
+
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "[Service] socket(): " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, cfg_.socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (!remove_stale_socket(addr)) {
+        ::close(listenFd);
+        return 1;
+    }
+
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listenFd, SOMAXCONN) < 0) {
+        std::cerr << "[Service] Не удалось открыть " << cfg_.socket_path
+                  << ": " << std::strerror(errno) << "\n";
+        ::close(listenFd);
+        return 1;
+    }
+
+    // Для сервиса история поиска не нужна: ответ уходит клиенту.
+    set_search_logging_enabled(false);
+
+    std::signal(SIGINT, handle_stop_signal);
+    std::signal(SIGTERM, handle_stop_signal);
+
+    int workers = std::max(1, cfg_.worker_threads);
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back(&QueryService::worker_loop, this);
+    }
+
+    std::cout << "[Service] Ожидание запросов на " << cfg_.socket_path
+              << " (потоков: " << workers << ")" << std::endl;
+
+    std::unordered_map<int, std::shared_ptr<Connection>> conns;
+    std::vector<pollfd> fds;
+
+    while (!g_stop.load()) {
+        fds.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        for (const auto& [fd, conn] : conns) {
+            fds.push_back({fd, POLLIN, 0});
+        }
+
+        int ready = ::poll(fds.data(), fds.size(), POLL_INTERVAL_MS);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "[Service] poll(): " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        if (ready > 0) {
+            for (size_t i = 1; i < fds.size(); ++i) {
+                if (fds[i].revents == 0) continue;
+                auto it = conns.find(fds[i].fd);
+                if (!read_from(it->second)) {
+                    conns.erase(it);
+                }
+            }
+
+            if (fds[0].revents & POLLIN) {
+                int clientFd = ::accept(listenFd, nullptr, nullptr);
+                if (clientFd >= 0) {
+                    timeval tv{SEND_TIMEOUT_S, 0};
+                    ::setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                    conns.emplace(clientFd, std::make_shared<Connection>(clientFd));
+                }
+            }
+        }
+
+        // Закрываем соединения, простаивающие дольше idle_timeout_ms
+        auto now = Clock::now();
+        for (auto it = conns.begin(); it != conns.end();) {
+            if (is_idle(*it->second, now)) {
+                it = conns.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    conns.clear();
+
+    // Захват мьютекса гарантирует, что ни один поток не застрял между
+    // проверкой условия и ожиданием, и уведомление не потеряется.
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+    }
+    queueCv_.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+    tasks_.clear();
+
+    ::close(listenFd);
+    ::unlink(cfg_.socket_path.c_str());
+    std::cout << "[Service] Остановлен" << std::endl;
+    return 0;
+}
+
+// Читает доступные данные и передаёт пулу завершённые строки.  Возвращает
+// false, если соединение нужно закрыть: клиент отключился, прислал слишком
+// длинную строку или слишком много запросов без чтения ответов.
+bool QueryService::read_from(const std::shared_ptr<Connection>& conn) {
+    char chunk[4096];
+    ssize_t got = ::recv(conn->fd, chunk, sizeof(chunk), 0);
+    if (got < 0 && (errno == EINTR || errno == EAGAIN)) return true;
+    if (got <= 0) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->lastActive = Clock::now();
+    }
+
+    std::string& buffer = conn->buffer;
+    buffer.append(chunk, static_cast<size_t>(got));
+
+    size_t start = 0;
+    size_t pos;
+    while ((pos = buffer.find('\n', start)) != std::string::npos) {
+        std::string line = buffer.substr(start, pos - start);
+        start = pos + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.size() > cfg_.max_line_length) {
+            send_line_nowait(*conn, "ERR строка длиннее " + std::to_string(cfg_.max_line_length) + " байт");
+            return false;
+        }
+        if (line.empty()) continue;
+        if (!submit(conn, std::move(line))) {
+            send_line_nowait(*conn, "ERR слишком много необработанных запросов");
+            return false;
+        }
+    }
+    buffer.erase(0, start);
+
+    if (buffer.size() > cfg_.max_line_length) {
+        send_line_nowait(*conn, "ERR строка длиннее " + std::to_string(cfg_.max_line_length) + " байт");
+        return false;
+    }
+    return true;
+}
+
+// Ставит строку в очередь соединения или сразу отдаёт её пулу, если у
+// соединения нет запроса в обработке.
+bool QueryService::submit(const std::shared_ptr<Connection>& conn, std::string line) {
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    if (conn->busy) {
+        if (conn->lines.size() >= cfg_.max_pending_lines) return false;
+        conn->lines.push_back(std::move(line));
+        return true;
+    }
+    conn->busy = true;
+    enqueue(Task{conn, std::move(line)});
+    return true;
+}
+
+void QueryService::enqueue(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        tasks_.push_back(std::move(task));
+    }
+    queueCv_.notify_one();
+}
+
+bool QueryService::is_idle(Connection& conn, Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(conn.mutex);
+    return !conn.busy &&
+           now - conn.lastActive > std::chrono::milliseconds(cfg_.idle_timeout_ms);
+}
+
+// Берёт очередной готовый запрос любого соединения, отвечает на него и
+// передаёт пулу следующий запрос того же соединения, если он уже пришёл.
+void QueryService::worker_loop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            queueCv_.wait(lock, [this] { return g_stop.load() || !tasks_.empty(); });
+            if (g_stop.load()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        send_line(*task.conn, handle_line(task.line));
+
+        std::lock_guard<std::mutex> lock(task.conn->mutex);
+        task.conn->lastActive = Clock::now();
+        if (task.conn->lines.empty()) {
+            task.conn->busy = false;
+        } else {
+            std::string next = std::move(task.conn->lines.front());
+            task.conn->lines.pop_front();
+            enqueue(Task{task.conn, std::move(next)});
+        }
+    }
+}
+
+std::string QueryService::handle_line(const std::string& line) {
+    std::istringstream in(line);
+    OptimizeRequest req;
+    in >> req.algorithm;
+
+    if (req.algorithm == "PING") {
+        return "PONG";
+    }
+    if (req.algorithm == "SHUTDOWN") {
+        g_stop.store(true);
+        return "BYE";
+    }
+    if (req.algorithm != "HC" && req.algorithm != "BEAM" && req.algorithm != "SA") {
+        return "ERR неизвестная команда: " + req.algorithm;
+    }
+
+    long long tables = 0;
+    long long seed   = 0;
+    if (!(in >> tables >> seed)) {
+        return "ERR ожидается: " + req.algorithm + " <num_tables> <seed>";
+    }
+    std::string extra;
+    if (req.algorithm == "HC" && (in >> extra)) {
+        if (extra == "first") {
+            req.strategy = HCStrategy::FirstImprovement;
+        } else if (extra != "best") {
+            return "ERR стратегия HC должна быть best или first";
+        }
+        extra.clear();
+    }
+    if (in >> extra) {
+        return "ERR лишние аргументы: " + extra;
+    }
+    if (tables < 1 || tables > cfg_.max_tables) {
+        return "ERR num_tables должно быть в диапазоне [1, " +
+               std::to_string(cfg_.max_tables) + "]";
+    }
+    if (seed < 0 || seed > 0xFFFFFFFFLL) {
+        return "ERR seed должен быть в диапазоне [0, 4294967295]";
+    }
+    req.num_tables = static_cast<int>(tables);
+    req.seed       = static_cast<unsigned>(seed);
+
+    return optimize(req);
+}
+
+// Возвращает ответ из кэша, присоединяется к уже идущему поиску с тем же
+// ключом или запускает новый поиск в текущем потоке.
+std::string QueryService::optimize(const OptimizeRequest& req) {
+    const std::string key = req.key();
+
+    std::promise<std::string> promise;
+    std::unique_lock<std::mutex> lock(resultsMutex_);
+    auto cached = cache_.find(key);
+    if (cached != cache_.end()) {
+        return cached->second;
+    }
+    auto running = inflight_.find(key);
+    if (running != inflight_.end()) {
+        std::shared_future<std::string> shared = running->second;
+        lock.unlock();
+        return shared.get();
+    }
+    inflight_.emplace(key, promise.get_future().share());
+    lock.unlock();
+
+    std::string response;
+    try {
+        response = run_optimization(req);
+    } catch (const std::exception& e) {
+        response = std::string("ERR ") + e.what();
+    }
+    promise.set_value(response);
+
+    lock.lock();
+    inflight_.erase(key);
+    if (response.compare(0, 3, "OK ") == 0) {
+        remember(key, response);
+    }
+    return response;
+}
+
+// Добавляет ответ в кэш, вытесняя самые старые записи (FIFO).
+// Вызывается под resultsMutex_.
+void QueryService::remember(const std::string& key, const std::string& response) {
+    if (cfg_.cache_capacity == 0) return;
+    if (!cache_.emplace(key, response).second) return;
+    cacheOrder_.push_back(key);
+    while (cacheOrder_.size() > cfg_.cache_capacity) {
+        cache_.erase(cacheOrder_.front());
+        cacheOrder_.pop_front();
+    }
+}
+
+} // namespace
+
+int run_query_service(const ServiceConfig& cfg) {
+    QueryService service(cfg);
+    return service.run();
+}